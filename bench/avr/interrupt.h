@@ -0,0 +1,15 @@
+//
+//  interrupt.h
+//  bench
+//
+//  Host stand-in for <avr/interrupt.h>, ISR becomes a plain function.
+//
+
+#ifndef bench_avr_interrupt_h
+#define bench_avr_interrupt_h
+
+#define ISR(vector) void vector(void)
+#define cli()
+#define sei()
+
+#endif /* bench_avr_interrupt_h */
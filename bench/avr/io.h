@@ -0,0 +1,23 @@
+//
+//  io.h
+//  bench
+//
+//  Host stand-in for <avr/io.h>, only to compile bme280.c/i2c.h for the
+//  host benchmark. Not used for AVR builds. Registers used with
+//  BME280_LOWPOWER are defined in bench.c.
+//
+
+#ifndef bench_avr_io_h
+#define bench_avr_io_h
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG, MCUSR, WDTCSR, TWCR;
+
+#define WDRF	3
+#define WDCE	4
+#define WDE		3
+#define WDIE	6
+#define TWSTO	4
+
+#endif /* bench_avr_io_h */
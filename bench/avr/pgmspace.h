@@ -0,0 +1,16 @@
+//
+//  pgmspace.h
+//  bench
+//
+//  Host stand-in for <avr/pgmspace.h>, tables stay in normal memory.
+//
+
+#ifndef bench_avr_pgmspace_h
+#define bench_avr_pgmspace_h
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+#endif /* bench_avr_pgmspace_h */
@@ -0,0 +1,19 @@
+//
+//  sleep.h
+//  bench
+//
+//  Host stand-in for <avr/sleep.h>, only to compile bme280.c with
+//  BME280_LOWPOWER for the energy model, never sleeps.
+//
+
+#ifndef bench_avr_sleep_h
+#define bench_avr_sleep_h
+
+#define SLEEP_MODE_PWR_DOWN	0x02
+
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()
+
+#endif /* bench_avr_sleep_h */
@@ -0,0 +1,14 @@
+//
+//  wdt.h
+//  bench
+//
+//  Host stand-in for <avr/wdt.h>.
+//
+
+#ifndef bench_avr_wdt_h
+#define bench_avr_wdt_h
+
+#define wdt_reset()
+#define wdt_disable()
+
+#endif /* bench_avr_wdt_h */
@@ -0,0 +1,526 @@
+//
+//  bench.c
+//  bench
+//
+//  Host benchmark for compensation of BME280: sweeps the raw value range
+//  of every compensation path for some calibration sets, compares library
+//  result with double precision formula of datasheet (chapter 8.1) and
+//  measures time per sample. "max err all" includes raw values outside the
+//  range of the sensor, where the library limits results (pressure >= 0,
+//  humidity 0...100 %) and the reference doesn't. Fails if "max err range"
+//  exceeds the limit of a variant.
+//  Derived values (bme280_derived.c) are swept over the range of the sensor
+//  and compared with double precision formulas, float versions with libm
+//  are timed for comparison, bme280_derive has to match the single functions.
+//  Timing and energy model (bme280_energyPerSample) is compared with
+//  hand-calculated values of some configurations, make bench builds it
+//  with each of them ("bench energy" checks the model only).
+//
+//  build and run with: make bench
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bme280.h"
+#include "bme280_derived.h"
+
+// I2C is not used by compensation, just satisfy linker
+void i2c_init(void){}
+void i2c_start(uint8_t i2c_addr){}
+void i2c_stop(void){}
+void i2c_byte(uint8_t byte){}
+uint8_t i2c_readAck(void){ return 0; }
+uint8_t i2c_readNAck(void){ return 0; }
+
+// registers used by bme280.c with BME280_LOWPOWER
+volatile uint8_t SREG, MCUSR, WDTCSR, TWCR;
+
+/****** calibration sets *******/
+// set 0: example of datasheet BMP280 (chapter 3.12) with typical humidity values
+// set 1, 2: typical values of BME280 modules
+static const bme280_calib_data calib_sets[] = {
+    { 27504, 26435, -1000,
+      36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000,
+      75, 362, 0, 313, 50, 30 },
+    { 28485, 26735, 50,
+      37008, -10589, 3024, 7774, -127, -7, 9900, -10230, 4285,
+      75, 353, 0, 340, 0, 30 },
+    { 27936, 26726, 50,
+      36889, -10692, 3024, 5791, -4, -7, 9900, -10230, 4285,
+      75, 365, 0, 302, 50, 30 },
+};
+#define CALIB_SETS (sizeof(calib_sets)/sizeof(calib_sets[0]))
+
+// temperatures for sweeping pressure and humidity (operating range of sensor)
+static const double sweep_temperatures[] = { -40.0, 0.0, 25.0, 85.0 };
+#define SWEEP_TEMPERATURES (sizeof(sweep_temperatures)/sizeof(sweep_temperatures[0]))
+
+static bme280_calib_data calib;
+static double t_fine_ref;
+
+/****** reference: double precision, datasheet chapter 8.1 *******/
+static double ref_temperature(int32_t adc_T){
+    double var1, var2;
+    var1 = ((double)adc_T/16384.0 - (double)calib.dig_T1/1024.0) * (double)calib.dig_T2;
+    var2 = ((double)adc_T/131072.0 - (double)calib.dig_T1/8192.0);
+    var2 = var2 * var2 * (double)calib.dig_T3;
+    t_fine_ref = var1 + var2;
+    return t_fine_ref / 5120.0;
+}
+
+static double ref_pressure(int32_t adc_P){
+    double var1, var2, p;
+    var1 = t_fine_ref/2.0 - 64000.0;
+    var2 = var1 * var1 * (double)calib.dig_P6 / 32768.0;
+    var2 = var2 + var1 * (double)calib.dig_P5 * 2.0;
+    var2 = var2/4.0 + (double)calib.dig_P4 * 65536.0;
+    var1 = ((double)calib.dig_P3 * var1 * var1 / 524288.0 + (double)calib.dig_P2 * var1) / 524288.0;
+    var1 = (1.0 + var1/32768.0) * (double)calib.dig_P1;
+    if (var1 == 0.0) {
+        return 0.0;
+    }
+    p = 1048576.0 - (double)adc_P;
+    p = (p - var2/4096.0) * 6250.0 / var1;
+    var1 = (double)calib.dig_P9 * p * p / 2147483648.0;
+    var2 = p * (double)calib.dig_P8 / 32768.0;
+    return p + (var1 + var2 + (double)calib.dig_P7) / 16.0;
+}
+
+static double ref_humidity(int32_t adc_H){
+    double h = t_fine_ref - 76800.0;
+    h = ((double)adc_H - ((double)calib.dig_H4 * 64.0 + (double)calib.dig_H5 / 16384.0 * h)) *
+        ((double)calib.dig_H2 / 65536.0 * (1.0 + (double)calib.dig_H6 / 67108864.0 * h *
+                                           (1.0 + (double)calib.dig_H3 / 67108864.0 * h)));
+    h = h * (1.0 - (double)calib.dig_H1 * h / 524288.0);
+    if (h > 100.0) {
+        h = 100.0;
+    } else if (h < 0.0) {
+        h = 0.0;
+    }
+    return h;
+}
+
+/****** library paths, converted like bme280_read... *******/
+static double lib_temperature(int32_t adc_T){
+    float T = bme280_compensateTemperature(adc_T, 0);
+    return T/100;
+}
+
+static double lib_pressure(int32_t adc_P){
+    return (float)bme280_compensatePressure(adc_P, 0)/256ul;
+}
+
+static double lib_humidity(int32_t adc_H){
+    float h = bme280_compensateHumidity(adc_H, 0);
+    return h / 1024;
+}
+
+/****** variants *******/
+typedef struct
+{
+    const char *name;
+    const char *unit;
+    double (*lib)(int32_t adc);
+    double (*ref)(int32_t adc);
+    int32_t adc_max;        // raw value range 0...adc_max
+    double min, max;        // operating range of sensor (by reference)
+    uint8_t temperatures;   // sweep at sweep_temperatures
+    double limit;           // max. allowed error in operating range
+} variant;
+
+static const variant variants[] = {
+    { "temperature", "C",   lib_temperature, ref_temperature, 0xFFFFF, -40.0, 85.0,     0, 0.01 },
+    { "pressure",    "Pa",  lib_pressure,    ref_pressure,    0xFFFFF, 30000.0, 110000.0, 1, 1.0 },
+    { "humidity",    "%RH", lib_humidity,    ref_humidity,    0xFFFF,  0.0, 100.0,      1, 0.01 },
+};
+#define VARIANTS (sizeof(variants)/sizeof(variants[0]))
+
+static void set_calibration(uint8_t set){
+    calib = calib_sets[set];
+    _bme280_calib[0].dig_T1 = calib.dig_T1;
+    _bme280_calib[0].dig_T2 = calib.dig_T2;
+    _bme280_calib[0].dig_T3 = calib.dig_T3;
+    _bme280_calib[0].dig_P1 = calib.dig_P1;
+    _bme280_calib[0].dig_P2 = calib.dig_P2;
+    _bme280_calib[0].dig_P3 = calib.dig_P3;
+    _bme280_calib[0].dig_P4 = calib.dig_P4;
+    _bme280_calib[0].dig_P5 = calib.dig_P5;
+    _bme280_calib[0].dig_P6 = calib.dig_P6;
+    _bme280_calib[0].dig_P7 = calib.dig_P7;
+    _bme280_calib[0].dig_P8 = calib.dig_P8;
+    _bme280_calib[0].dig_P9 = calib.dig_P9;
+    _bme280_calib[0].dig_H1 = calib.dig_H1;
+    _bme280_calib[0].dig_H2 = calib.dig_H2;
+    _bme280_calib[0].dig_H3 = calib.dig_H3;
+    _bme280_calib[0].dig_H4 = calib.dig_H4;
+    _bme280_calib[0].dig_H5 = calib.dig_H5;
+    _bme280_calib[0].dig_H6 = calib.dig_H6;
+}
+
+// raw temperature for temperature in celsius (by reference)
+static int32_t adc_for_temperature(double temperature){
+    int32_t low = 0, high = 0xFFFFF;
+    while (low < high) {
+        int32_t mid = (low + high) / 2;
+        if (ref_temperature(mid) < temperature) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// set t_fine of library and reference
+static void set_temperature(int32_t adc_T){
+    bme280_compensateTemperature(adc_T, 0);
+    ref_temperature(adc_T);
+}
+
+static double now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/****** derived values *******/
+static bme280_sample_data sample;
+static int16_t altitude;
+
+static double lib_dewPoint(void){
+    return bme280_dewPoint(&sample)/100.0;
+}
+
+static double ref_dewPoint(void){
+    if (sample.humidity == 0) {
+        return BME280_DEWPOINT_NONE/100.0;
+    }
+    double T = sample.temperature/100.0;
+    double RH = sample.humidity/1024.0;
+    if (RH < 1.0) {
+        RH = 1.0;
+    }
+    double gamma = log(RH/100.0) + 17.62*T/(243.12 + T);
+    return 243.12*gamma/(17.62 - gamma);
+}
+
+static double flt_dewPoint(void){
+    if (sample.humidity == 0) {
+        return BME280_DEWPOINT_NONE/100.0;
+    }
+    float T = sample.temperature/100.0f;
+    float RH = sample.humidity/1024.0f;
+    if (RH < 1.0f) {
+        RH = 1.0f;
+    }
+    float gamma = logf(RH/100.0f) + 17.62f*T/(243.12f + T);
+    return 243.12f*gamma/(17.62f - gamma);
+}
+
+static double lib_absoluteHumidity(void){
+    return bme280_absoluteHumidity(&sample);
+}
+
+static double ref_absoluteHumidity(void){
+    double T = sample.temperature/100.0;
+    double e = sample.humidity/102400.0 * 611.2*exp(17.62*T/(243.12 + T));
+    return 1000.0 * 18.01528/8.314462618 * e/(T + 273.15);
+}
+
+static double flt_absoluteHumidity(void){
+    float T = sample.temperature/100.0f;
+    float e = sample.humidity/102400.0f * 611.2f*expf(17.62f*T/(243.12f + T));
+    return 1000.0f * 2.166740f * e/(T + 273.15f);
+}
+
+static double lib_seaLevelPressure(void){
+    return bme280_seaLevelPressure(&sample, altitude)/256.0;
+}
+
+static double ref_seaLevelPressure(void){
+    return sample.pressure/256.0/pow(1.0 - altitude/44330.0, 1.0/0.1903);
+}
+
+static double flt_seaLevelPressure(void){
+    return sample.pressure/256.0f/powf(1.0f - altitude/44330.0f, 1.0f/0.1903f);
+}
+
+static double lib_derive(void){
+    bme280_derived_data derived;
+    bme280_derive(&sample, altitude, &derived);
+    return derived.dewPoint;
+}
+
+typedef struct
+{
+    const char *name;
+    const char *unit;
+    double (*lib)(void);
+    double (*ref)(void);    // NULL: only timing
+    double (*flt)(void);    // float with libm for comparison, NULL: none
+    uint8_t pressure;       // sweep pressure/altitude instead of temperature/humidity
+    double limit;           // max. allowed error
+} derived_variant;
+
+static const derived_variant derived_variants[] = {
+    { "dew point",   "C",     lib_dewPoint,         ref_dewPoint,         flt_dewPoint,         0, 0.01 },
+    { "abs. humid.", "mg/m3", lib_absoluteHumidity, ref_absoluteHumidity, flt_absoluteHumidity, 0, 15.0 },
+    { "QNH",         "Pa",    lib_seaLevelPressure, ref_seaLevelPressure, flt_seaLevelPressure, 1, 0.1 },
+    { "derive all",  "",      lib_derive,           NULL,                 NULL,                 0, 0.0 },
+};
+#define DERIVED_VARIANTS (sizeof(derived_variants)/sizeof(derived_variants[0]))
+
+// sweep over range of sensor: -40...85 C, 0...100 %, 300...1100 hPa, -500...9000 m,
+// compare with ref if not NULL, returns ns/sample
+static double sweep_derived(double (*func)(void), double (*ref)(void), uint8_t pressure, double *err){
+    volatile double sink;
+    uint32_t samples = 0;
+    *err = 0.0;
+
+    sample.temperature = 2000;
+    sample.humidity = 51200;
+    sample.pressure = 101325UL*256;
+    altitude = 0;
+
+    double start = now_ns();
+    for (uint32_t i = 0; ; i++) {
+        if (pressure) {
+            sample.pressure = (30000UL + (i / 381)*50)*256;
+            altitude = -500 + (int16_t)(i % 381)*25;
+            if (sample.pressure > 110000UL*256) break;
+        } else {
+            sample.temperature = -4000 + (int32_t)(i / 801)*25;
+            sample.humidity = (i % 801)*128;
+            if (sample.temperature > 8500) break;
+        }
+        sink = func();
+        if (ref != NULL) {
+            double e = fabs(sink - ref());
+            if (!(e <= *err)) {
+                *err = e; // NAN counts as worst
+            }
+        }
+        samples++;
+    }
+    (void)sink;
+    return (now_ns() - start)/samples;
+}
+
+// bme280_derive against single functions over -50...95 C (beyond limits),
+// 0...100 %, 300...1100 hPa, -500...9000 m, returns number of mismatches
+static uint32_t check_derive(uint32_t *samples){
+    uint32_t mismatches = 0;
+    *samples = 0;
+
+    for (int32_t temperature = -5000; temperature <= 9500; temperature += 25) {
+        for (uint32_t i = 0; i <= 800; i++) {
+            bme280_derived_data derived;
+            sample.temperature = temperature;
+            sample.humidity = i*128;
+            sample.pressure = (30000UL + ((*samples*37) % 1601)*50)*256;
+            altitude = -500 + (int16_t)((*samples*13) % 381)*25;
+
+            bme280_derive(&sample, altitude, &derived);
+            if (derived.dewPoint != bme280_dewPoint(&sample) ||
+                derived.absoluteHumidity != bme280_absoluteHumidity(&sample) ||
+                derived.seaLevelPressure != bme280_seaLevelPressure(&sample, altitude)) {
+                mismatches++;
+            }
+            (*samples)++;
+        }
+    }
+    return mismatches;
+}
+
+static uint8_t bench_derived(void){
+    uint8_t failed = 0;
+
+    printf("\nderived values (fixed point against double, float with libm for comparison)\n");
+    printf("%-12s %-6s %14s %10s %10s\n", "variant", "unit", "max err", "ns/sample", "float ns");
+
+    for (uint8_t v = 0; v < DERIVED_VARIANTS; v++) {
+        const derived_variant *var = &derived_variants[v];
+        double err = 0.0, unused;
+
+        if (var->ref != NULL) {
+            sweep_derived(var->lib, var->ref, var->pressure, &err);
+        }
+        double ns = sweep_derived(var->lib, NULL, var->pressure, &unused);
+        double ns_flt = 0.0;
+        if (var->flt != NULL) {
+            ns_flt = sweep_derived(var->flt, NULL, var->pressure, &unused);
+        }
+
+        if (var->ref != NULL) {
+            printf("%-12s %-6s %14.6g %10.2f %10.2f\n", var->name, var->unit, err, ns, ns_flt);
+        } else {
+            printf("%-12s %-6s %14s %10.2f %10s\n", var->name, var->unit, "-", ns, "-");
+        }
+        if (var->ref != NULL && !(err <= var->limit)) { // NAN fails too
+            printf("FAILED: max err > %g %s\n", var->limit, var->unit);
+            failed = 1;
+        }
+    }
+
+    uint32_t samples;
+    uint32_t mismatches = check_derive(&samples);
+    printf("derive all against single functions: %lu mismatches in %lu samples\n",
+           (unsigned long)mismatches, (unsigned long)samples);
+    if (mismatches != 0) {
+        printf("FAILED: bme280_derive differs from single functions\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+/****** timing and energy model *******/
+// hand-calculated with values of bme280.h (F_CPU 14.7456 MHz, F_I2C 100 kHz,
+// standby 250 ms, all oversamplings the same):
+// t_measure = 1250 + 2300*T + (2300*P + 575) + (2300*H + 575) us,
+// wake-ups = ceil(ceil(t_measure/1 ms)/16 ms), wake-up 16384/F_CPU + 10 us = 1121 us,
+// AVR awake 40 bytes*10/F_I2C + 1 ms = 5 ms per sample
+typedef struct
+{
+    uint8_t mode;
+    uint8_t over;
+    uint8_t lowpower;
+    uint32_t t_measure;     // us
+    uint32_t wakeups;       // watchdog wake-ups per sample
+    uint32_t energy_1s;     // uJ, one sample per second
+    uint32_t energy_60s;    // uJ, one sample per minute
+} energy_config;
+
+static const energy_config energy_configs[] = {
+    { BME280_NORMAL_MODE, OVER_16x, 0, 112800, 8,  447, 29800 },
+    { BME280_NORMAL_MODE, OVER_1x,  0,   9300, 1,  141,  4367 },
+    { BME280_FORCED_MODE, OVER_16x, 1, 112800, 8,  420,  1413 },
+    { BME280_FORCED_MODE, OVER_1x,  1,   9300, 1,  131,  1124 },
+    { BME280_FORCED_MODE, OVER_1x,  0,   9300, 1,  278,  1271 },
+};
+#define ENERGY_CONFIGS (sizeof(energy_configs)/sizeof(energy_configs[0]))
+
+static uint8_t bench_energy(void){
+    uint8_t failed = 0;
+    // has to be uint32_t to be calculated like on AVR, unsigned long of host is 64 bit
+    uint32_t t_wakeup = BME280_T_WAKEUP_us;
+    uint32_t e_1s = bme280_energyPerSample(1);
+    uint32_t e_60s = bme280_energyPerSample(60);
+
+    printf("\nenergy model (mode %s, oversampling %lux/%lux/%lux, lowpower %u)\n",
+           BME280_MODE_CONFIG == BME280_NORMAL_MODE ? "normal" : "forced",
+           (unsigned long)BME280_OVER_COUNT(BME280_TEMP_CONFIG),
+           (unsigned long)BME280_OVER_COUNT(BME280_PRESS_CONFIG),
+           (unsigned long)BME280_OVER_COUNT(BME280_HUM_CONFIG), BME280_LOWPOWER);
+    printf("t_measure %lu us, wake-up %lu us x %lu, %lu uJ/sample at 1 s, %lu uJ/sample at 60 s\n",
+           (unsigned long)BME280_T_MEASURE_us, (unsigned long)t_wakeup,
+           (unsigned long)BME280_WAKEUPS_PER_SAMPLE, (unsigned long)e_1s, (unsigned long)e_60s);
+
+    if (F_CPU != 14745600UL || F_I2C != 100000UL ||
+        (((BME280_CONFIG) >> 5) & 0x07) != BME280_STANDBY_250ms ||
+        BME280_PRESS_CONFIG != BME280_TEMP_CONFIG || BME280_HUM_CONFIG != BME280_TEMP_CONFIG) {
+        printf("no hand-calculated values for this configuration\n");
+        return 0;
+    }
+    if (sizeof(BME280_T_WAKEUP_us) != sizeof(uint32_t)) {
+        printf("FAILED: wake-up time not calculated with 32 bit as on AVR\n");
+        failed = 1;
+    }
+    if (t_wakeup != 1121) {
+        printf("FAILED: wake-up %lu us, expected 1121 us\n", (unsigned long)t_wakeup);
+        failed = 1;
+    }
+    for (uint8_t i = 0; i < ENERGY_CONFIGS; i++) {
+        const energy_config *config = &energy_configs[i];
+        if (config->mode != BME280_MODE_CONFIG || config->over != BME280_TEMP_CONFIG ||
+            config->lowpower != BME280_LOWPOWER) {
+            continue;
+        }
+        if (config->t_measure != BME280_T_MEASURE_us || config->wakeups != BME280_WAKEUPS_PER_SAMPLE ||
+            config->energy_1s != e_1s || config->energy_60s != e_60s) {
+            printf("FAILED: expected t_measure %lu us, %lu wake-ups, %lu uJ at 1 s, %lu uJ at 60 s\n",
+                   (unsigned long)config->t_measure, (unsigned long)config->wakeups,
+                   (unsigned long)config->energy_1s, (unsigned long)config->energy_60s);
+            failed = 1;
+        }
+        return failed;
+    }
+    printf("no hand-calculated values for this configuration\n");
+    return failed;
+}
+
+int main(int argc, char *argv[]){
+    uint8_t failed = 0;
+
+    if (argc > 1 && strcmp(argv[1], "energy") == 0) {
+        return bench_energy() ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    printf("BME280 compensation benchmark (host)\n");
+    printf("%-3s %-12s %-4s %14s %14s %10s %10s\n",
+           "set", "variant", "unit", "max err all", "max err range", "at adc", "ns/sample");
+
+    for (uint8_t set = 0; set < CALIB_SETS; set++) {
+        set_calibration(set);
+
+        int32_t adc_T[SWEEP_TEMPERATURES];
+        for (uint8_t i = 0; i < SWEEP_TEMPERATURES; i++) {
+            adc_T[i] = adc_for_temperature(sweep_temperatures[i]);
+        }
+
+        for (uint8_t v = 0; v < VARIANTS; v++) {
+            const variant *var = &variants[v];
+            uint8_t temperatures = var->temperatures ? SWEEP_TEMPERATURES : 1;
+            double err_all = 0.0, err_range = 0.0;
+            int32_t err_adc = 0;
+
+            // accuracy against reference
+            for (uint8_t i = 0; i < temperatures; i++) {
+                if (var->temperatures) {
+                    set_temperature(adc_T[i]);
+                }
+                for (int32_t adc = 0; adc <= var->adc_max; adc++) {
+                    double ref = var->ref(adc);
+                    double err = fabs(var->lib(adc) - ref);
+                    if (!(err <= err_all)) {
+                        err_all = err; // NAN counts as worst
+                    }
+                    if (ref >= var->min && ref <= var->max && !(err <= err_range)) {
+                        err_range = err;
+                        err_adc = adc;
+                    }
+                }
+            }
+
+            // time of library path only
+            volatile double sink;
+            double start = now_ns();
+            for (uint8_t i = 0; i < temperatures; i++) {
+                if (var->temperatures) {
+                    set_temperature(adc_T[i]);
+                }
+                for (int32_t adc = 0; adc <= var->adc_max; adc++) {
+                    sink = var->lib(adc);
+                }
+            }
+            double ns = (now_ns() - start) / ((double)temperatures * (var->adc_max + 1));
+            (void)sink;
+
+            printf("%-3u %-12s %-4s %14.6g %14.6g %10ld %10.2f\n",
+                   set, var->name, var->unit, err_all, err_range, (long)err_adc, ns);
+            if (!(err_range <= var->limit)) { // NAN fails too
+                printf("FAILED: max err range > %g %s\n", var->limit, var->unit);
+                failed = 1;
+            }
+        }
+    }
+    if (bench_derived()) {
+        failed = 1;
+    }
+    if (bench_energy()) {
+        failed = 1;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+//
+//  bench_avr.c
+//  bench
+//
+//  AVR benchmark for compensation of BME280: counts cycles of one
+//  compensation path (choose by BENCH_VARIANT) with Timer1 and prints
+//  them to simavr console. BENCH_VARIANT 0 is the empty baseline for
+//  flash/RAM size. Derived values are counted without compensation.
+//
+//  build and run with: make bench-avr
+//  (BENCH_SIMAVR and BENCH_MCU are set by Makefile if simavr headers exist)
+//
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <math.h>
+#include <stdio.h>
+#include "bme280.h"
+#include "bme280_derived.h"
+#ifdef BENCH_SIMAVR
+#include "avr_mcu_section.h" // from simavr
+#endif
+
+#define BENCH_NONE          0
+#define BENCH_TEMPERATURE   1
+#define BENCH_PRESSURE      2
+#define BENCH_HUMIDITY      3
+#define BENCH_DEWPOINT      4
+#define BENCH_ABSHUMIDITY   5
+#define BENCH_SEALEVEL      6
+#define BENCH_DEWPOINT_FLT  7   // float with libm for comparison
+#define BENCH_ABSHUMIDITY_FLT 8 // float with libm for comparison
+#define BENCH_SEALEVEL_FLT  9   // float with libm for comparison
+
+#ifndef BENCH_VARIANT
+#define BENCH_VARIANT BENCH_NONE
+#endif
+
+#ifndef BENCH_MCU
+#define BENCH_MCU "atmega328p"
+#endif
+
+#ifdef BENCH_SIMAVR
+AVR_MCU(F_CPU, BENCH_MCU);
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+#endif
+
+// I2C is not used by compensation, just satisfy linker
+void i2c_init(void){}
+void i2c_start(uint8_t i2c_addr){}
+void i2c_stop(void){}
+void i2c_byte(uint8_t byte){}
+uint8_t i2c_readAck(void){ return 0; }
+uint8_t i2c_readNAck(void){ return 0; }
+
+static int console_putchar(char c, FILE *stream){
+    GPIOR0 = c;
+    return 0;
+}
+static FILE console = FDEV_SETUP_STREAM(console_putchar, NULL, _FDEV_SETUP_WRITE);
+
+volatile uint16_t timer_overflows;
+ISR(TIMER1_OVF_vect){
+    timer_overflows++;
+}
+
+#if BENCH_VARIANT != BENCH_NONE
+// raw values over the range of the sensor (calibration set 0): -40...85 C, 300...1100 hPa, 0...100 %
+static const int32_t samples[][3] = {
+    { 0x4D000, 0xC4000, 0x5000 },
+    { 0x64000, 0xA8000, 0x6000 },
+    { 0x7A000, 0x8C000, 0x7000 },
+    { 0x8C000, 0x74000, 0x8000 },
+    { 0x9E000, 0x62000, 0x8800 },
+    { 0xAE000, 0x66000, 0x8400 },
+};
+#define SAMPLES (sizeof(samples)/sizeof(samples[0]))
+
+static uint32_t count_cycles(uint8_t i){
+#if BENCH_VARIANT == BENCH_DEWPOINT
+    volatile int32_t result;  // no conversion to float in timed code
+#elif BENCH_VARIANT == BENCH_ABSHUMIDITY || BENCH_VARIANT == BENCH_SEALEVEL
+    volatile uint32_t result;
+#else
+    volatile float result;
+#endif
+    uint16_t overflows;
+    uint16_t ticks;
+
+#if BENCH_VARIANT >= BENCH_DEWPOINT
+    bme280_sample_data sample;
+    sample.temperature = bme280_compensateTemperature(samples[i][0], 0);
+    sample.pressure = bme280_compensatePressure(samples[i][1], 0);
+    sample.humidity = bme280_compensateHumidity(samples[i][2], 0);
+#else
+    bme280_compensateTemperature(samples[i][0], 0); // t_fine for pressure and humidity
+#endif
+
+    timer_overflows = 0;
+    TCNT1 = 0;
+    TCCR1B = (1 << CS10); // start timer, no prescaler
+#if BENCH_VARIANT == BENCH_TEMPERATURE
+    float T = bme280_compensateTemperature(samples[i][0], 0);
+    result = T/100;
+#elif BENCH_VARIANT == BENCH_PRESSURE
+    result = (float)bme280_compensatePressure(samples[i][1], 0)/256ul;
+#elif BENCH_VARIANT == BENCH_HUMIDITY
+    float h = bme280_compensateHumidity(samples[i][2], 0);
+    result = h / 1024;
+#elif BENCH_VARIANT == BENCH_DEWPOINT
+    result = bme280_dewPoint(&sample);
+#elif BENCH_VARIANT == BENCH_ABSHUMIDITY
+    result = bme280_absoluteHumidity(&sample);
+#elif BENCH_VARIANT == BENCH_SEALEVEL
+    result = bme280_seaLevelPressure(&sample, 500);
+#elif BENCH_VARIANT == BENCH_DEWPOINT_FLT
+    // same as fixed point: humidity below 1 % is taken as 1 %
+    float T = sample.temperature/100.0f;
+    float RH = sample.humidity/1024.0f;
+    if (RH < 1.0f) {
+        RH = 1.0f;
+    }
+    float gamma = logf(RH/100.0f) + 17.62f*T/(243.12f + T);
+    result = 243.12f*gamma/(17.62f - gamma);
+#elif BENCH_VARIANT == BENCH_ABSHUMIDITY_FLT
+    float T = sample.temperature/100.0f;
+    float e = sample.humidity/102400.0f * 611.2f*expf(17.62f*T/(243.12f + T));
+    result = 1000.0f * 2.166740f * e/(T + 273.15f);
+#elif BENCH_VARIANT == BENCH_SEALEVEL_FLT
+    result = sample.pressure/256.0f/powf(1.0f - 500/44330.0f, 1.0f/0.1903f);
+#endif
+    TCCR1B = 0; // stop timer
+    ticks = TCNT1;
+    if (TIFR1 & (1 << TOV1)) { // overflow while timer stopped
+        TIFR1 = (1 << TOV1);
+        timer_overflows++;
+    }
+    overflows = timer_overflows;
+    (void)result;
+
+    return ((uint32_t)overflows << 16) | ticks;
+}
+#endif
+
+int main(void){
+    stdout = &console;
+
+    // calibration set 0 of host benchmark
+    _bme280_calib[0].dig_T1 = 27504;
+    _bme280_calib[0].dig_T2 = 26435;
+    _bme280_calib[0].dig_T3 = -1000;
+    _bme280_calib[0].dig_P1 = 36477;
+    _bme280_calib[0].dig_P2 = -10685;
+    _bme280_calib[0].dig_P3 = 3024;
+    _bme280_calib[0].dig_P4 = 2855;
+    _bme280_calib[0].dig_P5 = 140;
+    _bme280_calib[0].dig_P6 = -7;
+    _bme280_calib[0].dig_P7 = 15500;
+    _bme280_calib[0].dig_P8 = -14600;
+    _bme280_calib[0].dig_P9 = 6000;
+    _bme280_calib[0].dig_H1 = 75;
+    _bme280_calib[0].dig_H2 = 362;
+    _bme280_calib[0].dig_H3 = 0;
+    _bme280_calib[0].dig_H4 = 313;
+    _bme280_calib[0].dig_H5 = 50;
+    _bme280_calib[0].dig_H6 = 30;
+
+    TIMSK1 = (1 << TOIE1);
+    sei();
+
+#if BENCH_VARIANT != BENCH_NONE
+    uint32_t min = UINT32_MAX, max = 0, sum = 0;
+    for (uint8_t i = 0; i < SAMPLES; i++) {
+        uint32_t cycles = count_cycles(i);
+        if (cycles < min) min = cycles;
+        if (cycles > max) max = cycles;
+        sum += cycles;
+    }
+    printf("variant %d cycles: min %lu avg %lu max %lu\n",
+           BENCH_VARIANT, min, sum/SAMPLES, max);
+#endif
+
+    // sleep with interrupts disabled, simavr stops simulation
+    cli();
+    sleep_enable();
+    sleep_cpu();
+    return 0; // never reached
+}
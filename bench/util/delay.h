@@ -0,0 +1,13 @@
+//
+//  delay.h
+//  bench
+//
+//  Host stand-in for <util/delay.h>, no waiting needed on host.
+//
+
+#ifndef bench_util_delay_h
+#define bench_util_delay_h
+
+#define _delay_ms(ms)
+
+#endif /* bench_util_delay_h */
@@ -9,6 +9,88 @@
 #include "bme280.h"
 #include <math.h>       // for NAN & pow()
 #include <util/delay.h> // needed delay after softreset
+#if BME280_LOWPOWER
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+static volatile uint8_t bme280_wdt_wakeup;
+
+/**********************************************
+ Interrupt: WDT_vect
+ 
+ Purpose: Wake up AVR from sleep, mark end of watchdog period
+ **********************************************/
+ISR(WDT_vect){
+    bme280_wdt_wakeup = 1;
+}
+
+/**********************************************
+ Private Function: bme280_sleep16ms
+ 
+ Purpose: Put AVR into BME280_MCU_SLEEP for one watchdog period (16 ms)
+ 
+ Input Parameter: none
+ 
+ Return Value: none
+ **********************************************/
+static void bme280_sleep16ms(void){
+    // i2c_stop() doesn't wait for the stop-condition, TWI would freeze
+    // in power-down with half sent stop-condition
+    uint16_t timeout = F_CPU/F_I2C*2.0;
+    while ((TWCR & (1 << TWSTO)) && timeout != 0) {
+        timeout--;
+    }
+    
+    uint8_t sreg = SREG;
+    cli();
+    // start watchdog in interrupt mode, 16 ms timeout
+    bme280_wdt_wakeup = 0;
+    wdt_reset();
+    MCUSR &= ~(1 << WDRF);
+    WDTCSR = (1 << WDCE)|(1 << WDE);
+    WDTCSR = (1 << WDIE);
+    
+    set_sleep_mode(BME280_MCU_SLEEP);
+    // every interrupt (e.g. timer, pin change) wakes up AVR,
+    // sleep again until watchdog interrupt
+    while (!bme280_wdt_wakeup) {
+        sleep_enable();
+        sei();
+        sleep_cpu(); // no interrupt between sei and sleep
+        sleep_disable();
+        cli();
+    }
+    
+    wdt_disable();
+    SREG = sreg;
+}
+#endif
+
+/**********************************************
+ Private Function: bme280_wait_ms
+ 
+ Purpose: Wait some milliseconds, sleeping in whole watchdog periods
+          (16 ms) if BME280_LOWPOWER is set
+ 
+ Input Parameter: uint16_t ms: time to wait in milliseconds
+ 
+ Return Value: none
+ **********************************************/
+static void bme280_wait_ms(uint16_t ms){
+#if BME280_LOWPOWER
+    // rest is rounded up to one more period, sleeping longer needs
+    // less energy than busy waiting
+    while (ms > 0) {
+        bme280_sleep16ms();
+        ms = (ms > 16) ? ms - 16 : 0;
+    }
+#else
+    while (ms--) {
+        _delay_ms(1);
+    }
+#endif
+}
 
 /**********************************************
  Public Function: bme280_init
@@ -39,7 +121,7 @@ uint8_t bme280_init(uint8_t sensor){
         i2c_byte(0xB6);
         i2c_stop();
         // wait for finished softreset
-        _delay_ms(10);
+        bme280_wait_ms(10);
         
         // start to write config via I2C
         i2c_start(0xec|((1-sensor)<<1));
@@ -59,7 +141,7 @@ uint8_t bme280_init(uint8_t sensor){
         i2c_stop();
         
         // wait for finished softreset
-        _delay_ms(10);
+        bme280_wait_ms(10);
         
         // start to write config via I2C
         i2c_start(0xec|((1-sensor)<<1));
@@ -80,13 +162,108 @@ uint8_t bme280_init(uint8_t sensor){
     i2c_stop();
     
     // wait for adjust configs
-    _delay_ms(100);
+    bme280_wait_ms(100);
     
     // read coefficients
     bme280_readCoefficients(sensor);
     return returnValue;
 }
 
+/**********************************************
+ Public Function: bme280_compensateTemperature
+ 
+ Purpose: Calculate temperature from raw value, sets t_fine of sensor
+ 
+ Input Parameter: int32_t adc_T: raw value of temperature (20 bit)
+                  uint8_t sensor: choose sensor (calibration data)
+ 
+ Return Value: int32_t
+ - temperature in 0.01 celsius
+ **********************************************/
+int32_t bme280_compensateTemperature(int32_t adc_T, uint8_t sensor){
+    int32_t var1, var2;
+    
+    var1  = ((((adc_T>>3) - ((int32_t)_bme280_calib[sensor].dig_T1 <<1))) *
+             ((int32_t)_bme280_calib[sensor].dig_T2)) >> 11;
+    
+    var2  = (((((adc_T>>4) - ((int32_t)_bme280_calib[sensor].dig_T1)) *
+               ((adc_T>>4) - ((int32_t)_bme280_calib[sensor].dig_T1))) >> 12) *
+             ((int32_t)_bme280_calib[sensor].dig_T3)) >> 14;
+    
+    t_fine[sensor] = var1 + var2;
+    
+    return (t_fine[sensor] * 5 + 128) >> 8;
+}
+
+/**********************************************
+ Public Function: bme280_compensatePressure
+ 
+ Purpose: Calculate pressure from raw value,
+          bme280_compensateTemperature must be done first to get t_fine
+ 
+ Input Parameter: int32_t adc_P: raw value of pressure (20 bit)
+                  uint8_t sensor: choose sensor (calibration data)
+ 
+ Return Value: uint32_t
+ - pressure in Pa as Q24.8 (value/256 = Pa), 0 if result is negative
+ **********************************************/
+uint32_t bme280_compensatePressure(int32_t adc_P, uint8_t sensor){
+    int64_t var1, var2, p;
+    
+    var1 = ((int64_t)t_fine[sensor]) - (int64_t)128000;
+    var2 = var1 * var1 * (int64_t)_bme280_calib[sensor].dig_P6;
+    var2 = var2 + ((var1*(int64_t)_bme280_calib[sensor].dig_P5)<<17);
+    var2 = var2 + (((int64_t)_bme280_calib[sensor].dig_P4)<<35);
+    var1 = ((var1 * var1 * (int64_t)_bme280_calib[sensor].dig_P3)>>8) +
+    ((var1 * (int64_t)_bme280_calib[sensor].dig_P2)<<12);
+    var1 = (((((int64_t)1)<<47)+var1))*((int64_t)_bme280_calib[sensor].dig_P1)>>33;
+    
+    if (var1 == 0) {
+        return 0; // avoid exception caused by division by zero
+    }
+    p = (int64_t)1048576 - adc_P;
+    p = (((p<<31) - var2)*(int64_t)3125) / var1;
+    var1 = (((int64_t)_bme280_calib[sensor].dig_P9) * (p>>13) * (p>>13)) >> 25;
+    var2 = (((int64_t)_bme280_calib[sensor].dig_P8) * p) >> 19;
+    
+    p = ((p + var1 + var2) >> 8) + (((int64_t)_bme280_calib[sensor].dig_P7)<<4);
+    if (p < 0) {
+        return 0; // only for raw values outside range of sensor
+    }
+    return (uint32_t)p;
+}
+
+/**********************************************
+ Public Function: bme280_compensateHumidity
+ 
+ Purpose: Calculate humidity from raw value,
+          bme280_compensateTemperature must be done first to get t_fine
+ 
+ Input Parameter: int32_t adc_H: raw value of humidity (16 bit)
+                  uint8_t sensor: choose sensor (calibration data)
+ 
+ Return Value: uint32_t
+ - humidity in % as Q22.10 (value/1024 = %)
+ **********************************************/
+uint32_t bme280_compensateHumidity(int32_t adc_H, uint8_t sensor){
+    int32_t v_x1_u32r;
+    
+    v_x1_u32r = (t_fine[sensor] - ((int32_t)76800));
+    
+    v_x1_u32r = (((((adc_H << 14) - (((int32_t)_bme280_calib[sensor].dig_H4) << 20) -
+                    (((int32_t)_bme280_calib[sensor].dig_H5) * v_x1_u32r)) + ((int32_t)16384)) >> 15) *
+                 (((((((v_x1_u32r * ((int32_t)_bme280_calib[sensor].dig_H6)) >> 10) *
+                      (((v_x1_u32r * ((int32_t)_bme280_calib[sensor].dig_H3)) >> 11) + ((int32_t)32768))) >> 10) +
+                    ((int32_t)2097152)) * ((int32_t)_bme280_calib[sensor].dig_H2) + 8192) >> 14));
+    
+    v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) *
+                               ((int32_t)_bme280_calib[sensor].dig_H1)) >> 4));
+    
+    v_x1_u32r = (v_x1_u32r < 0) ? 0 : v_x1_u32r;
+    v_x1_u32r = (v_x1_u32r > 419430400) ? 419430400 : v_x1_u32r;
+    return (uint32_t)(v_x1_u32r>>12);
+}
+
 /**********************************************
  Public Function: bme280_readTemperature
  
@@ -103,25 +280,13 @@ float bme280_readTemperature(uint8_t sensor){
         return NAN;
     }
     
-    uint32_t adc_T = bme280_read3Byte(BME280_REGISTER_TEMPDATA, sensor);
+    int32_t adc_T = bme280_read3Byte(BME280_REGISTER_TEMPDATA, sensor);
     
     if (adc_T == 0x800000) // value in case temperature measurement was disabled
         return NAN;
-    int32_t var1, var2;
-    
     adc_T >>= 4;
     
-    var1  = ((((adc_T>>3) - ((int32_t)_bme280_calib[sensor].dig_T1 <<1))) *
-             ((int32_t)_bme280_calib[sensor].dig_T2)) >> 11;
-    
-    var2  = (((((adc_T>>4) - ((int32_t)_bme280_calib[sensor].dig_T1)) *
-               ((adc_T>>4) - ((int32_t)_bme280_calib[sensor].dig_T1))) >> 12) *
-             ((int32_t)_bme280_calib[sensor].dig_T3)) >> 14;
-    
-    t_fine[sensor] = var1 + var2;
-    
-    float T  = (t_fine[sensor] * 5 + 128) >> 8;
-    
+    float T = bme280_compensateTemperature(adc_T, sensor);
     return T/100;
 }
 
@@ -141,8 +306,6 @@ float bme280_readPressure(uint8_t sensor){
         return NAN;
     }
     
-    int64_t var1, var2, p;
-    
     bme280_readTemperature(sensor); // must be done first to get t_fine
     
     int32_t adc_P = bme280_read3Byte(BME280_REGISTER_PRESSUREDATA, sensor);
@@ -150,24 +313,7 @@ float bme280_readPressure(uint8_t sensor){
         return NAN;
     adc_P >>= 4;
     
-    var1 = ((int64_t)t_fine[sensor]) - 128000ul;
-    var2 = var1 * var1 * (int64_t)_bme280_calib[sensor].dig_P6;
-    var2 = var2 + ((var1*(int64_t)_bme280_calib[sensor].dig_P5)<<17);
-    var2 = var2 + (((int64_t)_bme280_calib[sensor].dig_P4)<<35);
-    var1 = ((var1 * var1 * (int64_t)_bme280_calib[sensor].dig_P3)>>8) +
-    ((var1 * (int64_t)_bme280_calib[sensor].dig_P2)<<12);
-    var1 = (((((int64_t)1)<<47)+var1))*((int64_t)_bme280_calib[sensor].dig_P1)>>33;
-    
-    if (var1 == 0) {
-        return 0; // avoid exception caused by division by zero
-    }
-    p = 1048576ul - adc_P;
-    p = (((p<<31) - var2)*3125ul) / var1;
-    var1 = (((int64_t)_bme280_calib[sensor].dig_P9) * (p>>13) * (p>>13)) >> 25;
-    var2 = (((int64_t)_bme280_calib[sensor].dig_P8) * p) >> 19;
-    
-    p = ((p + var1 + var2) >> 8) + (((int64_t)_bme280_calib[sensor].dig_P7)<<4);
-    return (float)p/256ul;
+    return (float)bme280_compensatePressure(adc_P, sensor)/256ul;
 }
 
 /**********************************************
@@ -194,22 +340,8 @@ float bme280_readHumidity(uint8_t sensor){
     int32_t adc_H = bme280_read2Byte(BME280_REGISTER_HUMIDDATA, sensor);
     if (adc_H == 0x8000) // value in case humidity measurement was disabled
         return NAN;
-    int32_t v_x1_u32r;
-    
-    v_x1_u32r = (t_fine[sensor] - ((int32_t)76800));
     
-    v_x1_u32r = (((((adc_H << 14) - (((int32_t)_bme280_calib[sensor].dig_H4) << 20) -
-                    (((int32_t)_bme280_calib[sensor].dig_H5) * v_x1_u32r)) + ((int32_t)16384)) >> 15) *
-                 (((((((v_x1_u32r * ((int32_t)_bme280_calib[sensor].dig_H6)) >> 10) *
-                      (((v_x1_u32r * ((int32_t)_bme280_calib[sensor].dig_H3)) >> 11) + ((int32_t)32768))) >> 10) +
-                    ((int32_t)2097152)) * ((int32_t)_bme280_calib[sensor].dig_H2) + 8192) >> 14));
-    
-    v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) *
-                               ((int32_t)_bme280_calib[sensor].dig_H1)) >> 4));
-    
-    v_x1_u32r = (v_x1_u32r < 0) ? 0 : v_x1_u32r;
-    v_x1_u32r = (v_x1_u32r > 419430400) ? 419430400 : v_x1_u32r;
-    float h = (v_x1_u32r>>12);
+    float h = bme280_compensateHumidity(adc_H, sensor);
     return  h / 1024;
 }
 
@@ -236,6 +368,161 @@ float bme280_readAltitude(float seaLevel, uint8_t sensor){
     return 44330.0 * (1.0 - pow(atmospheric / seaLevel, 0.1903));
 }
 
+/**********************************************
+ Public Function: bme280_readSample
+ 
+ Purpose: Read temperature, pressure and humidity with one burst read
+          and compensate them (consistent values from same conversion)
+ 
+ Input Parameter: bme280_sample_data *sample: compensated values
+                  uint8_t sensor: choose sensor on I2C
+ 
+ Return Value: uint8_t
+ - Value 0x00 means sample read
+ - Value 0xff means temperature measurement disabled or argue out of range
+ **********************************************/
+uint8_t bme280_readSample(bme280_sample_data *sample, uint8_t sensor){
+    if (sensor > SENSORS-1) { // argue sensor out of range
+        return 0xff;
+    }
+    
+    // burst read of pressure (0xF7...0xF9), temperature (0xFA...0xFC), humidity (0xFD...0xFE)
+    uint8_t data[8];
+    i2c_start(0xec|((1-sensor)<<1));
+    i2c_byte(BME280_REGISTER_PRESSUREDATA);
+    i2c_stop();
+    i2c_start((0xec|((1-sensor)<<1))|0x01);
+    for (uint8_t i = 0; i < 7; i++) {
+        data[i] = i2c_readAck();
+    }
+    data[7] = i2c_readNAck();
+    i2c_stop();
+    
+    int32_t adc_P = ((uint32_t)data[0] << 12)|((uint32_t)data[1] << 4)|(data[2] >> 4);
+    int32_t adc_T = ((uint32_t)data[3] << 12)|((uint32_t)data[4] << 4)|(data[5] >> 4);
+    int32_t adc_H = ((uint16_t)data[6] << 8)|data[7];
+    
+    if (adc_T == 0x80000) // value in case temperature measurement was disabled
+        return 0xff;
+    sample->temperature = bme280_compensateTemperature(adc_T, sensor);
+    
+    if (adc_P == 0x80000) // value in case pressure measurement was disabled
+        sample->pressure = 0;
+    else
+        sample->pressure = bme280_compensatePressure(adc_P, sensor);
+    
+    // BMP280 has no humidity calibration (all 0), compensation returns 0
+    if (adc_H == 0x8000) // value in case humidity measurement was disabled
+        sample->humidity = 0;
+    else
+        sample->humidity = bme280_compensateHumidity(adc_H, sensor);
+    
+    return 0x00;
+}
+
+/**********************************************
+ Public Function: bme280_measure
+ 
+ Purpose: Start one conversion in forced mode and wait until it's finished,
+          sensor returns to sleep mode afterwards.
+          Use it with BME280_MODE_CONFIG set to BME280_FORCED_MODE,
+          with BME280_LOWPOWER set AVR sleeps during conversion.
+ 
+ Input Parameter: uint8_t sensor: choose sensor on I2C
+ 
+ Return Value: uint8_t
+ - Value 0x00 means conversion finished
+ - Value 0xff means timeout or argue out of range
+ **********************************************/
+uint8_t bme280_measure(uint8_t sensor){
+    if (sensor > SENSORS-1) { // argue sensor out of range
+        return 0xff;
+    }
+    
+    // write config for pressure, temperture and forced mode, starts conversion
+    i2c_start(0xec|((1-sensor)<<1));
+    i2c_byte(BME280_REGISTER_CONTROL);
+    i2c_byte((BME280_TEMP_CONFIG << 5)|(BME280_PRESS_CONFIG << 2)|(BME280_FORCED_MODE));
+    i2c_stop();
+    
+    // wait max. conversion time, then check measuring-bit of sensor
+    bme280_wait_ms(BME280_T_WAIT_ms);
+    uint8_t timeout = 10;
+    while (bme280_read1Byte(BME280_REGISTER_STATUS, sensor) & (1 << 3)) {
+        if (timeout-- == 0) {
+            return 0xff;
+        }
+        bme280_wait_ms(1);
+    }
+    return 0x00;
+}
+
+/**********************************************
+ Public Function: bme280_energyPerSample
+ 
+ Purpose: Estimate energy for one sample of sensor and AVR by timing model
+          (see timing model and energy values in bme280.h).
+          In forced mode one conversion per sample is counted, in normal
+          mode all conversions done by sensor during interval.
+ 
+ Input Parameter: uint16_t interval: time between two samples in seconds
+ 
+ Return Value: uint32_t
+ - energy per sample in uJ
+ **********************************************/
+uint32_t bme280_energyPerSample(uint16_t interval){
+    // all charges in pC (uA * us)
+    const uint64_t q_conversion = BME280_IDD_T_uA*(1250UL+BME280_T_MEASURE_T_us) +
+                                  BME280_IDD_P_uA*BME280_T_MEASURE_P_us +
+                                  BME280_IDD_H_uA*BME280_T_MEASURE_H_us;
+    uint64_t t_interval = (uint64_t)interval*1000000UL;
+    uint64_t t_active = BME280_T_AWAKE_us;
+    uint64_t t_wait = BME280_T_MEASURE_us; // AVR waits for conversion
+    uint64_t q_sensor;
+    
+#if BME280_MODE_CONFIG != BME280_NORMAL_MODE
+#if BME280_LOWPOWER
+    t_wait = BME280_WAKEUPS_PER_SAMPLE*16000UL;
+#else
+    t_wait = BME280_T_WAIT_ms*1000UL;
+#endif
+#endif
+    if (t_interval < t_wait + t_active) {
+        t_interval = t_wait + t_active;
+    }
+    
+#if BME280_MODE_CONFIG == BME280_NORMAL_MODE
+    // sensor converts continuously, standby-time between conversions
+    const uint32_t t_standby[] = {500UL, 62500UL, 125000UL, 250000UL,
+                                  500000UL, 1000000UL, 10000UL, 20000UL};
+    uint32_t t_period = BME280_T_MEASURE_us + t_standby[((BME280_CONFIG) >> 5) & 0x07];
+    uint64_t conversions = t_interval/t_period;
+    if (conversions == 0) {
+        conversions = 1;
+    }
+    q_sensor = conversions*q_conversion +
+               (t_interval - conversions*BME280_T_MEASURE_us)*BME280_IDD_SB_nA/1000UL;
+#else
+    // one conversion, sensor sleeps for rest of interval
+    q_sensor = q_conversion +
+               (t_interval - BME280_T_MEASURE_us)*BME280_IDD_SLEEP_nA/1000UL;
+#if BME280_LOWPOWER
+    // AVR sleeps during conversion, wakes up by watchdog every 16 ms,
+    // status poll is part of BME280_T_AWAKE_us
+    t_active += BME280_WAKEUPS_PER_SAMPLE*BME280_T_WAKEUP_us;
+#else
+    // AVR is busy waiting for end of conversion
+    t_active += t_wait;
+#endif
+#endif
+    
+    uint64_t q_mcu = t_active*BME280_MCU_ACTIVE_uA +
+                     (t_interval - t_active)*BME280_MCU_SLEEP_uA;
+    
+    // pC * mV = fJ
+    return (uint32_t)((q_sensor + q_mcu)*BME280_SUPPLY_mV/1000000000UL);
+}
+
 uint8_t bme280_read1Byte(uint8_t addr, uint8_t sensor){
     uint8_t value;
     i2c_start(0xec|((1-sensor)<<1));
@@ -51,17 +51,78 @@ extern "C" {
 
 /****** settings *******/
 // default: Standby-Time = 250ms, IIR-Filter = 16x, SPI disable, Oversampling for all Sensors = 16x, Normal Mode
+// oversampling, mode and BME280_LOWPOWER can also be set by compiler options (-D...)
 
 // Standby-Time, IIR-Filter, SPI Disable
 #define BME280_CONFIG		(BME280_STANDBY_250ms << 5)|(BME280_IIR_8x << 2)|(BME280_SPI_OFF)
 // Temperatur-Sensor
+#ifndef BME280_TEMP_CONFIG
 #define BME280_TEMP_CONFIG	OVER_16x
+#endif
 // Pressure-Sensor
+#ifndef BME280_PRESS_CONFIG
 #define BME280_PRESS_CONFIG	OVER_16x
+#endif
 // Humitity-Sensor
+#ifndef BME280_HUM_CONFIG
 #define BME280_HUM_CONFIG	OVER_16x
+#endif
 // Mode
+#ifndef BME280_MODE_CONFIG
 #define BME280_MODE_CONFIG	BME280_NORMAL_MODE
+#endif
+
+/****** low power *******/
+// 1: let the AVR sleep (power-down, woken by watchdog interrupt every 16 ms)
+//    during conversions and the waits in bme280_init instead of busy waiting,
+//    waits are rounded up to 16 ms, other interrupts don't shorten them
+//    !!!library uses WDT_vect and the watchdog while sleeping!!!
+// 0: busy waiting with _delay_ms (default)
+#ifndef BME280_LOWPOWER
+#define BME280_LOWPOWER		0
+#endif
+// sleep mode of AVR while waiting, see avr/sleep.h
+#define BME280_MCU_SLEEP	SLEEP_MODE_PWR_DOWN
+
+// values for energy model (bme280_energyPerSample), adjust to your hardware
+#define BME280_SUPPLY_mV		3300	// supply voltage of sensor and AVR
+#define BME280_MCU_ACTIVE_uA	5000	// current of AVR running at F_CPU
+#define BME280_MCU_SLEEP_uA		5		// current of AVR in BME280_MCU_SLEEP incl. watchdog
+
+/****** timing model *******/
+// values from datasheet BME280, chapter 9.1 and 9.2 (maximum values)
+#define BME280_OVER_COUNT(over)	((over) == OVER_0x ? 0UL : ((over) >= OVER_16x ? 16UL : (1UL << ((over)-1))))
+
+#define BME280_T_MEASURE_T_us	(2300UL*BME280_OVER_COUNT(BME280_TEMP_CONFIG))
+#define BME280_T_MEASURE_P_us	(BME280_PRESS_CONFIG == OVER_0x ? 0UL : 2300UL*BME280_OVER_COUNT(BME280_PRESS_CONFIG)+575UL)
+#define BME280_T_MEASURE_H_us	(BME280_HUM_CONFIG == OVER_0x ? 0UL : 2300UL*BME280_OVER_COUNT(BME280_HUM_CONFIG)+575UL)
+// max. time for one conversion of all enabled measurements
+#define BME280_T_MEASURE_us		(1250UL+BME280_T_MEASURE_T_us+BME280_T_MEASURE_P_us+BME280_T_MEASURE_H_us)
+
+// current consumption of sensor while measuring and sleeping
+#define BME280_IDD_T_uA		350UL
+#define BME280_IDD_P_uA		714UL
+#define BME280_IDD_H_uA		340UL
+#define BME280_IDD_SLEEP_nA	100UL
+#define BME280_IDD_SB_nA	200UL
+
+// estimated time AVR is awake per sample (bme280_measure and reading
+// temperature, pressure and humidity): I2C-bytes with 9 clocks each
+// plus start/stop and calculation of compensated values
+#define BME280_I2C_BYTES_PER_SAMPLE	40UL
+#define BME280_T_CALC_us			1000UL
+#define BME280_T_AWAKE_us		(BME280_I2C_BYTES_PER_SAMPLE*10UL*1000000UL/F_I2C+BME280_T_CALC_us)
+
+// time bme280_measure waits for end of conversion (rounded up to ms)
+#define BME280_T_WAIT_ms		((BME280_T_MEASURE_us+999UL)/1000UL)
+
+// with BME280_LOWPOWER: watchdog wake-ups while waiting for conversion in
+// bme280_measure (wait rounded up to whole 16 ms periods), each with
+// start-up time of oscillator from power-down (16K CK for crystal, see
+// fuses SUT/CKSEL) and ISR, counted at BME280_MCU_ACTIVE_uA,
+// uint32_t: calculated with 32 bit as on AVR also by host bench
+#define BME280_T_WAKEUP_us			((uint32_t)16384*1000/((uint32_t)F_CPU/1000)+10)
+#define BME280_WAKEUPS_PER_SAMPLE	((BME280_T_WAIT_ms+15UL)/16UL)
 
 #include <stdio.h>
 #include "i2c.h"
@@ -91,6 +152,13 @@ typedef struct
 
 } bme280_calib_data;
 
+typedef struct
+{
+    int32_t  temperature;   // 0.01 celsius
+    uint32_t pressure;      // Pa as Q24.8, 0 if measurement disabled
+    uint32_t humidity;      // % as Q22.10, 0 if measurement disabled or BMP280
+} bme280_sample_data;
+
 enum
 {
     BME280_REGISTER_DIG_T1              = 0x88,
@@ -120,6 +188,7 @@ enum
     
     BME280_REGISTER_CAL26              = 0xE1,  // R calibration stored in 0xE1-0xF0
     
+    BME280_REGISTER_STATUS             = 0xF3,  // bit 3: measuring, bit 0: im_update
     BME280_REGISTER_CONTROL            = 0xF4,
     BME280_REGISTER_CONFIG             = 0xF5,
     BME280_REGISTER_PRESSUREDATA       = 0xF7,
@@ -137,6 +206,15 @@ float bme280_readPressure(uint8_t sensor);
 float bme280_readHumidity(uint8_t sensor);
 float bme280_readAltitude(float seaLevel, uint8_t sensor);
 
+int32_t bme280_compensateTemperature(int32_t adc_T, uint8_t sensor);
+uint32_t bme280_compensatePressure(int32_t adc_P, uint8_t sensor);
+uint32_t bme280_compensateHumidity(int32_t adc_H, uint8_t sensor);
+
+uint8_t bme280_readSample(bme280_sample_data *sample, uint8_t sensor);
+
+uint8_t bme280_measure(uint8_t sensor);
+uint32_t bme280_energyPerSample(uint16_t interval);
+
 uint8_t bme280_read1Byte(uint8_t addr, uint8_t sensor);
 uint16_t bme280_read2Byte(uint8_t addr, uint8_t sensor);
 uint32_t bme280_read3Byte(uint8_t addr, uint8_t sensor);
@@ -147,7 +225,7 @@ uint16_t read16_LE(uint8_t reg, uint8_t sensor);
 int16_t readS16(uint8_t reg, uint8_t sensor);
 int16_t readS16_LE(uint8_t reg, uint8_t sensor);
 
-volatile uint32_t t_fine[SENSORS];
+volatile int32_t t_fine[SENSORS];
 volatile bme280_calib_data _bme280_calib[SENSORS];
 
 #ifdef __cplusplus
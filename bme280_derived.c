@@ -0,0 +1,334 @@
+//
+//  bme280_derived.c
+//  i2c
+//
+//  Dew point and absolute humidity are calculated in log2-domain (Q16) with
+//  table-driven log2 and exp2 (64 segments, interpolation), sea-level
+//  pressure with series in Q28, no float and no libm.
+//  Max. error against double precision formulas (measured by make bench,
+//  -40...85 C, 0...100 %, 300...1100 hPa, -500...9000 m):
+//  dew point 0.0075 C, absolute humidity 9.3 mg/m^3 (< 0.003 %),
+//  sea-level pressure 0.04 Pa
+//
+
+#include "bme280_derived.h"
+#include <avr/pgmspace.h>
+
+// log2(1 + i/64) as Q16
+static const uint16_t log2_table[64] PROGMEM = {
+        0,  1466,  2909,  4331,  5732,  7112,  8473,  9814,
+    11136, 12440, 13727, 14996, 16248, 17484, 18704, 19909,
+    21098, 22272, 23433, 24579, 25711, 26830, 27936, 29029,
+    30109, 31178, 32234, 33279, 34312, 35334, 36346, 37346,
+    38336, 39316, 40286, 41246, 42196, 43137, 44068, 44990,
+    45904, 46809, 47705, 48593, 49472, 50344, 51207, 52063,
+    52911, 53751, 54584, 55410, 56229, 57040, 57845, 58643,
+    59434, 60219, 60997, 61769, 62534, 63294, 64047, 64794,
+};
+
+// 2^(i/64) - 1 as Q16
+static const uint16_t exp2_table[64] PROGMEM = {
+        0,   714,  1435,  2164,  2902,  3647,  4400,  5162,
+     5932,  6710,  7496,  8292,  9096,  9908, 10730, 11560,
+    12400, 13249, 14106, 14974, 15850, 16737, 17633, 18538,
+    19454, 20379, 21315, 22260, 23216, 24183, 25160, 26148,
+    27146, 28155, 29175, 30207, 31249, 32303, 33369, 34446,
+    35534, 36635, 37747, 38872, 40009, 41158, 42320, 43495,
+    44682, 45882, 47095, 48322, 49562, 50815, 52082, 53363,
+    54658, 55966, 57289, 58627, 59979, 61346, 62727, 64124,
+};
+
+// Magnus formula (b = 17.62, c = 243.12 C) and constants, logarithms as Q16
+#define MAGNUS_C            24312L      // c in 0.01 C
+#define MAGNUS_B_LOG2E      1665944L    // b*log2(e)
+#define LOG2_RH100          1090772L    // log2(100 % as Q22.10)
+#define LOG2_RH_MIN         655360L     // log2(1 % as Q22.10), dew point limit
+#define LOG2_AH             1768205L    // log2(611.2 Pa * M_w/R * 1000 mg/g * 100)
+
+// barometric formula (troposphere), factors as Q28
+#define Q28                 268435456L  // 1.0
+#define BAROMETRIC_EXP_Q24  88161934L   // 1/0.1903 as Q24
+#define ALTITUDE_MIN        -1000       // limits of altitude in m
+#define ALTITUDE_MAX        11000
+
+/**********************************************
+ Private Function: bme280_log2
+
+ Purpose: Calculate log2 of an integer
+
+ Input Parameter: uint32_t x: value, must be > 0
+
+ Return Value: int32_t
+ - log2(x) as Q16
+ **********************************************/
+static int32_t bme280_log2(uint32_t x){
+    int8_t n = 31;
+    while (!(x & 0x80000000UL)) { // normalize, mantissa 1.xxx in bit 31...0
+        x <<= 1;
+        n--;
+    }
+    uint8_t i = (x >> 25) & 0x3F;   // segment
+    uint32_t r = (x >> 9) & 0xFFFF; // position in segment, Q16
+    uint32_t lo = pgm_read_word(&log2_table[i]);
+    uint32_t hi = (i < 63) ? pgm_read_word(&log2_table[i+1]) : 65536UL;
+    uint32_t d = hi - lo;
+    // log2 is concave, chord is below: add ln(2)/2*d^2*r*(1-r) (second order)
+    uint32_t corr = (((d*d) >> 4)*355) >> 10;
+    corr = (corr*((r*(65536UL - r)) >> 16) + (1UL << 27)) >> 28;
+    return ((int32_t)n << 16) + lo + ((d*r + 32768UL) >> 16) + corr;
+}
+
+/**********************************************
+ Private Function: bme280_exp2
+
+ Purpose: Calculate 2^y
+
+ Input Parameter: int32_t y: exponent as Q16, must be < 32
+
+ Return Value: uint32_t
+ - 2^y, 0 if < 1
+ **********************************************/
+static uint32_t bme280_exp2(int32_t y){
+    int8_t n = y >> 16;
+    uint8_t i = (y >> 10) & 0x3F;   // segment
+    uint32_t r = y & 0x3FF;         // position in segment, Q10
+    uint32_t lo = pgm_read_word(&exp2_table[i]);
+    uint32_t hi = (i < 63) ? pgm_read_word(&exp2_table[i+1]) : 65536UL;
+    uint32_t d = hi - lo;
+    // 2^y is convex, chord is above: subtract ln(2)/128*d*r*(1-r) (second order)
+    uint32_t corr = ((((d*(r*(1024UL - r))) >> 12)*355) + (1UL << 23)) >> 24;
+    uint32_t m = 65536UL + lo + ((d*r + 512) >> 10) - corr; // mantissa 1.xxx as Q16
+    if (n >= 16) {
+        return m << (n - 16);
+    }
+    if (n <= -16) {
+        return 0;
+    }
+    return m >> (16 - n);
+}
+
+/**********************************************
+ Private Function: bme280_mulQ28
+ 
+ Purpose: Multiply two Q28 values with rounding
+ 
+ Input Parameter: int32_t a: factor as Q28
+                  int32_t b: factor as Q28
+ 
+ Return Value: int32_t
+ - a*b as Q28
+ **********************************************/
+static int32_t bme280_mulQ28(int32_t a, int32_t b){
+    return ((int64_t)a*b + (1L << 27)) >> 28;
+}
+
+/**********************************************
+ Private Function: bme280_limitTemperature
+
+ Purpose: Limit temperature to range of sensor (-40...85 C), keeps all
+          fixed point calculations in 32 bit
+
+ Input Parameter: int32_t temperature: temperature in 0.01 celsius
+
+ Return Value: int32_t
+ - temperature in 0.01 celsius, -4000...8500
+ **********************************************/
+static int32_t bme280_limitTemperature(int32_t temperature){
+    if (temperature < -4000) {
+        return -4000;
+    }
+    if (temperature > 8500) {
+        return 8500;
+    }
+    return temperature;
+}
+
+/**********************************************
+ Private Function: bme280_magnus
+
+ Purpose: Calculate log2 of water vapour pressure relative to 611.2 Pa,
+          ln(e/611.2 Pa) = ln(RH/100 %) + b*T/(c+T) (Magnus formula)
+
+ Input Parameter: const bme280_sample_data *sample: compensated values
+                  int32_t log2_rh: log2 of humidity (Q22.10) as Q16
+
+ Return Value: int32_t
+ - log2(e/611.2 Pa) as Q16
+ **********************************************/
+static int32_t bme280_magnus(const bme280_sample_data *sample, int32_t log2_rh){
+    int32_t t = bme280_limitTemperature(sample->temperature);
+
+    // b*log2(e)*T/(c+T) as Q16, long division with 16 fraction bits
+    uint32_t num = (t < 0 ? -t : t)*254203UL; // b*log2(e)*10000
+    uint32_t den = (MAGNUS_C + t)*10000UL;
+    uint32_t q = num/den;
+    uint32_t r = num%den;
+    for (uint8_t i = 0; i < 16; i++) {
+        r <<= 1;
+        q <<= 1;
+        if (r >= den) {
+            r -= den;
+            q |= 1;
+        }
+    }
+    int32_t log2_t = (t < 0) ? -(int32_t)q : (int32_t)q;
+
+    return log2_rh - LOG2_RH100 + log2_t;
+}
+
+/**********************************************
+ Private Function: bme280_dewPointMagnus
+
+ Purpose: Calculate dew point from result of bme280_magnus,
+          Td = c*gamma/(b*log2(e)-gamma) with gamma = log2(e/611.2 Pa)
+
+ Input Parameter: int32_t gamma: log2(e/611.2 Pa) as Q16
+
+ Return Value: int32_t
+ - dew point in 0.01 celsius
+ **********************************************/
+static int32_t bme280_dewPointMagnus(int32_t gamma){
+    gamma = (gamma + 8) >> 4; // Q12, keeps c*gamma in 32 bit
+    int32_t den = ((MAGNUS_B_LOG2E + 8) >> 4) - gamma;
+    int32_t num = MAGNUS_C*gamma;
+    num += (num < 0) ? -den/2 : den/2; // round
+    return num/den;
+}
+
+/**********************************************
+ Private Function: bme280_absoluteHumidityMagnus
+
+ Purpose: Calculate absolute humidity from result of bme280_magnus,
+          AH = e*M_w/(R*T)
+
+ Input Parameter: int32_t gamma: log2(e/611.2 Pa) as Q16
+                  int32_t temperature: temperature in 0.01 celsius
+
+ Return Value: uint32_t
+ - absolute humidity in mg/m^3
+ **********************************************/
+static uint32_t bme280_absoluteHumidityMagnus(int32_t gamma, int32_t temperature){
+    temperature = bme280_limitTemperature(temperature); // same as in bme280_magnus
+    return bme280_exp2(LOG2_AH + gamma - bme280_log2(temperature + 27315L));
+}
+
+/**********************************************
+ Public Function: bme280_dewPoint
+
+ Purpose: Calculate dew point (Magnus formula)
+
+ Input Parameter: const bme280_sample_data *sample: compensated values
+
+ Return Value: int32_t
+ - dew point in 0.01 celsius (humidity below 1 % is taken as 1 %,
+   temperature outside -40...85 C as limit of range, result saturates)
+ - BME280_DEWPOINT_NONE if humidity is 0 (not measured)
+ **********************************************/
+int32_t bme280_dewPoint(const bme280_sample_data *sample){
+    if (sample->humidity == 0) {
+        return BME280_DEWPOINT_NONE;
+    }
+    int32_t log2_rh = (sample->humidity > 1024) ? bme280_log2(sample->humidity) : LOG2_RH_MIN;
+    return bme280_dewPointMagnus(bme280_magnus(sample, log2_rh));
+}
+
+/**********************************************
+ Public Function: bme280_absoluteHumidity
+
+ Purpose: Calculate absolute humidity
+
+ Input Parameter: const bme280_sample_data *sample: compensated values
+
+ Return Value: uint32_t
+ - absolute humidity in mg/m^3 (temperature outside -40...85 C is taken
+   as limit of range, result saturates)
+ - 0 if humidity is 0 (not measured)
+ **********************************************/
+uint32_t bme280_absoluteHumidity(const bme280_sample_data *sample){
+    if (sample->humidity == 0) {
+        return 0;
+    }
+    int32_t gamma = bme280_magnus(sample, bme280_log2(sample->humidity));
+    return bme280_absoluteHumidityMagnus(gamma, sample->temperature);
+}
+
+/**********************************************
+ Public Function: bme280_seaLevelPressure
+
+ Purpose: Calculate pressure at sealevel (QNH) by barometric formula,
+          inverse of bme280_readAltitude: P0 = P/(1 - h/44330)^5.255
+
+ Input Parameter: const bme280_sample_data *sample: compensated values
+                  int16_t altitude: altitude of sensor in meter,
+                  limited to -1000...11000 m (troposphere)
+
+ Return Value: uint32_t
+ - pressure at sealevel in Pa as Q24.8, 0 if pressure measurement disabled
+ **********************************************/
+uint32_t bme280_seaLevelPressure(const bme280_sample_data *sample, int16_t altitude){
+    if (sample->pressure == 0) {
+        return 0;
+    }
+    if (altitude < ALTITUDE_MIN) {
+        altitude = ALTITUDE_MIN;
+    } else if (altitude > ALTITUDE_MAX) {
+        altitude = ALTITUDE_MAX;
+    }
+    
+    // 1 - h/44330 = (1 - z)/(1 + z) with z = h/(2*44330 - h), |z| < 0.15:
+    // u = -ln(1 - h/44330) = 2*atanh(z) = 2*(z + z^3/3 + z^5/5 + z^7/7 + z^9/9)
+    int32_t z = ((int64_t)altitude << 28)/(88660L - altitude);
+    int32_t z2 = bme280_mulQ28(z, z);
+    int32_t u = Q28/9;
+    u = Q28/7 + bme280_mulQ28(z2, u);
+    u = Q28/5 + bme280_mulQ28(z2, u);
+    u = Q28/3 + bme280_mulQ28(z2, u);
+    u = Q28 + bme280_mulQ28(z2, u);
+    u = 2*bme280_mulQ28(z, u);
+    
+    // (1 - h/44330)^-5.255 = exp(y)^16 with y = 5.255*u/16, |y| < 0.1:
+    // exp(y) = 1 + y*(1 + y/2*(1 + y/3*(1 + y/4*(1 + y/5))))
+    int32_t y = ((int64_t)u*BAROMETRIC_EXP_Q24 + (1L << 27)) >> 28;
+    int32_t k = Q28 + y/5;
+    k = Q28 + bme280_mulQ28(y, k)/4;
+    k = Q28 + bme280_mulQ28(y, k)/3;
+    k = Q28 + bme280_mulQ28(y, k)/2;
+    k = Q28 + bme280_mulQ28(y, k);
+    for (uint8_t i = 0; i < 4; i++) {
+        k = bme280_mulQ28(k, k);
+    }
+    
+    return ((uint64_t)sample->pressure*k + (1UL << 27)) >> 28;
+}
+
+/**********************************************
+ Public Function: bme280_derive
+
+ Purpose: Calculate all derived values from one sample,
+          log2 of humidity and Magnus term are calculated once,
+          same limits as bme280_dewPoint and bme280_absoluteHumidity
+
+ Input Parameter: const bme280_sample_data *sample: compensated values
+                  int16_t altitude: altitude of sensor in meter
+                  bme280_derived_data *derived: derived values
+
+ Return Value: none
+ **********************************************/
+void bme280_derive(const bme280_sample_data *sample, int16_t altitude, bme280_derived_data *derived){
+    if (sample->humidity == 0) { // humidity not measured
+        derived->dewPoint = BME280_DEWPOINT_NONE;
+        derived->absoluteHumidity = 0;
+    } else {
+        int32_t log2_rh = bme280_log2(sample->humidity);
+        int32_t gamma = bme280_magnus(sample, log2_rh);
+        
+        // Magnus term is linear in log2_rh, limit humidity for dew point to 1 %
+        if (log2_rh < LOG2_RH_MIN) {
+            derived->dewPoint = bme280_dewPointMagnus(gamma - log2_rh + LOG2_RH_MIN);
+        } else {
+            derived->dewPoint = bme280_dewPointMagnus(gamma);
+        }
+        derived->absoluteHumidity = bme280_absoluteHumidityMagnus(gamma, sample->temperature);
+    }
+    derived->seaLevelPressure = bme280_seaLevelPressure(sample, altitude);
+}
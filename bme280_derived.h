@@ -0,0 +1,38 @@
+//
+//  bme280_derived.h
+//  i2c
+//
+//  Derived values (dew point, absolute humidity, sea-level pressure)
+//  calculated in fixed point from compensated values of bme280.
+//
+
+#ifndef bme280_derived_h
+#define bme280_derived_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bme280.h"
+
+// dew point without humidity (humidity of sample is 0: BMP280 or humidity disabled)
+#define BME280_DEWPOINT_NONE	INT32_MIN
+
+typedef struct
+{
+    int32_t  dewPoint;          // 0.01 celsius
+    uint32_t absoluteHumidity;  // mg/m^3
+    uint32_t seaLevelPressure;  // Pa as Q24.8
+} bme280_derived_data;
+
+int32_t bme280_dewPoint(const bme280_sample_data *sample);
+uint32_t bme280_absoluteHumidity(const bme280_sample_data *sample);
+uint32_t bme280_seaLevelPressure(const bme280_sample_data *sample, int16_t altitude);
+
+void bme280_derive(const bme280_sample_data *sample, int16_t altitude, bme280_derived_data *derived);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* bme280_derived_h */